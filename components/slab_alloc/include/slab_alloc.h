@@ -0,0 +1,70 @@
+/*
+Slab allocator with per-core caches.
+
+Requests up to SLAB_MAX_OBJECT_SIZE bytes are rounded up to one of SLAB_NUM_CLASSES size classes and served
+from slabs (fixed size blocks taken from the heap, see CONFIG_SLAB_ALLOC_SLAB_SIZE). Larger requests go
+straight to the heap. Every core keeps a small cache of free objects per class, so the common path never
+touches memory shared with the other core.
+
+All memory comes from internal RAM, never from PSRAM, so it can hold TCBs and task stacks.
+
+All functions must be called from task context, not from an ISR.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SLAB_NUM_CLASSES        14
+#define SLAB_MAX_OBJECT_SIZE    2048
+
+// Called when an allocation of size bytes fails (if the heap ran out, after the allocator has given its cached
+// memory back to it). Return true to retry the allocation, false to make it return NULL. Before returning true
+// the callback must free memory or block until some is freed, otherwise the allocation retries in a busy loop.
+typedef bool (*slab_oom_cb_t)(size_t size, void *arg);
+
+typedef struct {
+    size_t object_size;
+    uint32_t slabs;
+    uint32_t objects_total;         // capacity of all slabs of this class
+    uint32_t objects_in_use;        // held by the application
+    uint32_t objects_cached;        // free, parked in the per-core caches
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    float waste;                    // share of the handed out bytes that were not asked for (rounding up)
+} slab_class_stats_t;
+
+typedef struct {
+    slab_class_stats_t classes[SLAB_NUM_CLASSES];
+    uint32_t slabs;
+    size_t slab_bytes;              // memory held by the allocator
+    float slab_fragmentation;       // share of slab memory not holding live objects
+    uint32_t large_in_use;          // requests above SLAB_MAX_OBJECT_SIZE, served by the heap
+    uint32_t large_failures;
+    size_t heap_free;               // internal RAM
+    size_t heap_largest_free_block;
+    float heap_fragmentation;       // 1 - largest free block / free bytes
+} slab_stats_t;
+
+void *slab_malloc(size_t size);
+void *slab_calloc(size_t n, size_t size);
+void slab_free(void *ptr);
+
+// Give the objects cached by every core and all empty slabs back to the heap.
+void slab_trim(void);
+
+void slab_set_oom_callback(slab_oom_cb_t callback, void *arg);
+
+void slab_get_stats(slab_stats_t *stats);
+void slab_print_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
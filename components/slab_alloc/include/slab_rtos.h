@@ -0,0 +1,41 @@
+/*
+FreeRTOS objects backed by the slab allocator.
+
+These wrap the xxxCreateStatic() APIs: the control block and the storage come from slab_malloc(), so queues,
+buffers and tasks that are created and deleted over and over reuse the same slab memory instead of leaving
+holes in the heap. Objects created here must be deleted with the matching slab_xxx_delete() function.
+*/
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/message_buffer.h"
+#include "freertos/stream_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+QueueHandle_t slab_queue_create(UBaseType_t queueLength, UBaseType_t itemSize);
+void slab_queue_delete(QueueHandle_t queue);
+
+MessageBufferHandle_t slab_message_buffer_create(size_t bufferSizeBytes);
+void slab_message_buffer_delete(MessageBufferHandle_t messageBuffer);
+
+StreamBufferHandle_t slab_stream_buffer_create(size_t bufferSizeBytes, size_t triggerLevelBytes);
+void slab_stream_buffer_delete(StreamBufferHandle_t streamBuffer);
+
+// Same parameters as xTaskCreatePinnedToCore(). Returns pdPASS, or errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY.
+BaseType_t slab_task_create_pinned_to_core(TaskFunction_t taskCode, const char *name, uint32_t stackDepth,
+                                           void *parameters, UBaseType_t priority, TaskHandle_t *createdTask,
+                                           BaseType_t coreId);
+
+// Delete a task created by slab_task_create_pinned_to_core() and release its stack and TCB. A task cannot
+// delete itself this way, its stack would be released while still in use.
+void slab_task_delete(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
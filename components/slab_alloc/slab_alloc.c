@@ -0,0 +1,575 @@
+/*
+Slab allocator.
+
+Layout: memory is taken from the heap in slabs of SLAB_SIZE bytes, aligned to SLAB_SIZE. The slab header sits
+at the start of the slab, followed by equally sized objects of one size class. Since slabs are aligned, the
+slab an object belongs to is found by masking the object address, and slab_free() needs no per-object header.
+The header records the slab's index in the slab table, so slab_free() confirms the slab with a single lookup.
+
+Free objects live in two places:
+- the per-core caches, a small stack of objects per class and core, protected by a lock that only tasks on
+  that core normally take, and
+- the free lists of the slabs (the depot), shared by both cores and protected by depotLock.
+
+Allocation pops from the local cache and refills it with half a cache worth of objects from the depot when it
+is empty. Free pushes to the local cache and moves half of it back to the depot when it is full. Lock order is
+always cache lock first, then depotLock.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "slab_alloc.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+#define SLAB_SIZE           CONFIG_SLAB_ALLOC_SLAB_SIZE
+#define CACHE_SIZE          CONFIG_SLAB_ALLOC_CACHE_SIZE
+#define CACHE_BATCH         (CACHE_SIZE / 2)                // objects moved between a cache and the depot at once
+#define OBJECT_ALIGN        16
+#define SLAB_HEADER_SIZE    ((sizeof(slab_t) + OBJECT_ALIGN - 1) & ~(OBJECT_ALIGN - 1))
+
+// Internal RAM only: with PSRAM enabled, 8-bit capable memory may be external, and TCBs and task stacks handed
+// to xTaskCreateStatic() must not be.
+#define HEAP_CAPS           (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+typedef struct slab {
+    struct slab *next;              // partial list links
+    struct slab *prev;
+    void *freeList;                 // free objects, linked through their first word
+    uint16_t classIdx;
+    uint16_t used;                  // objects out of the slab, including the ones sitting in core caches
+    uint16_t capacity;
+    uint16_t index;                 // in slabSlots
+} slab_t;
+
+typedef struct {
+    slab_t *partial;                // slabs with at least one free object, empty ones included
+    uint32_t slabs;
+    uint32_t emptySlabs;
+    uint32_t used;                  // sum of slab_t::used
+    uint32_t failures;
+} slab_class_t;
+
+typedef struct {
+    void *objs[CACHE_SIZE];
+    uint32_t count;
+    uint32_t allocs;
+    uint32_t frees;
+    uint64_t requestedBytes;
+    uint64_t grantedBytes;
+} core_cache_t;
+
+typedef enum {
+    ALLOC_OK,
+    ALLOC_NO_HEAP,                  // the heap could not provide a slab or a large block
+    ALLOC_NO_SLAB,                  // CONFIG_SLAB_ALLOC_MAX_SLABS reached
+} alloc_result_t;
+
+static const uint16_t classSizes[SLAB_NUM_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+_Static_assert(SLAB_MAX_OBJECT_SIZE == 2048, "classSizes and SLAB_MAX_OBJECT_SIZE are out of sync");
+_Static_assert(SLAB_HEADER_SIZE + SLAB_MAX_OBJECT_SIZE <= SLAB_SIZE, "largest class does not fit in a slab");
+
+static const char* TAG = "slab_alloc";
+
+static slab_class_t classes[SLAB_NUM_CLASSES];
+static core_cache_t caches[portNUM_PROCESSORS][SLAB_NUM_CLASSES];
+static portMUX_TYPE cacheLock[portNUM_PROCESSORS] = { [0 ... portNUM_PROCESSORS - 1] = portMUX_INITIALIZER_UNLOCKED };
+static portMUX_TYPE depotLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Every slab owned by the allocator. A slot only changes while its slab holds no live objects, so slab_free()
+// can read it without a lock: the slab of the object being freed cannot disappear underneath it.
+static slab_t *volatile slabSlots[CONFIG_SLAB_ALLOC_MAX_SLABS];
+
+static uint32_t largeInUse = 0;
+static uint32_t largeFailures = 0;
+
+static slab_oom_cb_t oomCallback = NULL;
+static void *oomCallbackArg = NULL;
+
+
+// Slabs and large blocks both start on a SLAB_SIZE boundary. For a large block, slab_of() then reads the start
+// of the block itself, rather than whatever lies below it (which on the chip may be a hole in the memory map).
+static void *heap_alloc_aligned(size_t size)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return aligned_alloc(SLAB_SIZE, (size + SLAB_SIZE - 1) & ~(size_t)(SLAB_SIZE - 1));
+#else
+    return heap_caps_aligned_alloc(SLAB_SIZE, size, HEAP_CAPS);
+#endif
+}
+
+static void heap_free_aligned(void *ptr)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    free(ptr);
+#else
+    heap_caps_aligned_free(ptr);
+#endif
+}
+
+static int size_to_class(size_t size)
+{
+    for (int i = 0; i < SLAB_NUM_CLASSES; ++i)
+    {
+        if (size <= classSizes[i])
+            return i;
+    }
+
+    return -1;
+}
+
+// The slab ptr belongs to, or NULL if ptr came from the heap directly.
+static slab_t *slab_of(void *ptr)
+{
+    slab_t *base = (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+
+    // If ptr is a large block, base is ptr itself and index is whatever the application stored there. No slot
+    // can hold base then: the block would have to lie inside one of our slabs.
+    uint16_t index = base->index;
+
+    if (index < CONFIG_SLAB_ALLOC_MAX_SLABS && slabSlots[index] == base)
+        return base;
+
+    return NULL;
+}
+
+static void partial_push(slab_class_t *cls, slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = cls->partial;
+    if (cls->partial != NULL)
+        cls->partial->prev = slab;
+    cls->partial = slab;
+}
+
+static void partial_remove(slab_class_t *cls, slab_t *slab)
+{
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        cls->partial = slab->next;
+
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+
+    slab->next = slab->prev = NULL;
+}
+
+// Take an empty slab out of its class and the slab table and chain it on *release, to be handed back to the heap
+// once the locks are dropped. Call with depotLock held.
+static void slab_retire(slab_class_t *cls, slab_t *slab, slab_t **release)
+{
+    partial_remove(cls, slab);
+    --cls->emptySlabs;
+    --cls->slabs;
+    slabSlots[slab->index] = NULL;
+
+    slab->next = *release;
+    *release = slab;
+}
+
+// Move up to count objects of class classIdx from the slabs into objs. Call with depotLock held.
+static uint32_t depot_take(int classIdx, void **objs, uint32_t count)
+{
+    slab_class_t *cls = &classes[classIdx];
+    uint32_t taken = 0;
+
+    while (taken < count && cls->partial != NULL)
+    {
+        slab_t *slab = cls->partial;
+        void *obj = slab->freeList;
+
+        slab->freeList = *(void **)obj;
+        if (slab->used++ == 0)
+            --cls->emptySlabs;
+        ++cls->used;
+
+        if (slab->freeList == NULL)             // full now
+            partial_remove(cls, slab);
+
+        objs[taken++] = obj;
+    }
+
+    return taken;
+}
+
+// Give count objects back to their slabs. Empty slabs above CONFIG_SLAB_ALLOC_MAX_EMPTY_SLABS are retired onto
+// *release. Call with depotLock held.
+static void depot_put(void **objs, uint32_t count, slab_t **release)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        slab_t *slab = (slab_t *)((uintptr_t)objs[i] & ~(uintptr_t)(SLAB_SIZE - 1));
+        slab_class_t *cls = &classes[slab->classIdx];
+
+        if (slab->freeList == NULL)             // was full
+            partial_push(cls, slab);
+
+        *(void **)objs[i] = slab->freeList;
+        slab->freeList = objs[i];
+        --cls->used;
+
+        if (--slab->used == 0 && ++cls->emptySlabs > CONFIG_SLAB_ALLOC_MAX_EMPTY_SLABS)
+            slab_retire(cls, slab, release);
+    }
+}
+
+static void release_slabs(slab_t *release)
+{
+    while (release != NULL)
+    {
+        slab_t *next = release->next;
+        heap_free_aligned(release);
+        release = next;
+    }
+}
+
+// Add a fresh slab to class classIdx.
+static alloc_result_t slab_grow(int classIdx)
+{
+    slab_t *slab = heap_alloc_aligned(SLAB_SIZE);
+    if (slab == NULL)
+        return ALLOC_NO_HEAP;
+
+    size_t objectSize = classSizes[classIdx];
+    uint8_t *first = (uint8_t *)slab + SLAB_HEADER_SIZE;
+
+    memset(slab, 0, sizeof(*slab));
+    slab->classIdx = classIdx;
+    slab->capacity = (SLAB_SIZE - SLAB_HEADER_SIZE) / objectSize;
+
+    // Chain the objects, lowest address first
+    for (int i = slab->capacity - 1; i >= 0; --i)
+    {
+        void *obj = first + i * objectSize;
+        *(void **)obj = slab->freeList;
+        slab->freeList = obj;
+    }
+
+    bool registered = false;
+
+    portENTER_CRITICAL(&depotLock);
+    for (int s = 0; s < CONFIG_SLAB_ALLOC_MAX_SLABS; ++s)
+    {
+        if (slabSlots[s] == NULL)
+        {
+            slab->index = s;
+            slabSlots[s] = slab;
+            registered = true;
+            break;
+        }
+    }
+
+    if (registered)
+    {
+        slab_class_t *cls = &classes[classIdx];
+        partial_push(cls, slab);
+        ++cls->slabs;
+        ++cls->emptySlabs;
+    }
+    portEXIT_CRITICAL(&depotLock);
+
+    if (!registered)
+    {
+        heap_free_aligned(slab);
+        return ALLOC_NO_SLAB;
+    }
+
+    return ALLOC_OK;
+}
+
+// Pop an object of class classIdx from the local core's cache, refilling it from the depot if needed.
+static void *cache_pop(int classIdx, size_t requested)
+{
+    // If the task migrates to the other core after reading the core id, it merely uses that core's cache with
+    // the right lock held, so this stays correct; it is just not local for that one call.
+    int core = xPortGetCoreID();
+    core_cache_t *cache = &caches[core][classIdx];
+    void *obj = NULL;
+
+    portENTER_CRITICAL(&cacheLock[core]);
+    if (cache->count == 0)
+    {
+        portENTER_CRITICAL(&depotLock);
+        cache->count = depot_take(classIdx, cache->objs, CACHE_BATCH);
+        portEXIT_CRITICAL(&depotLock);
+    }
+
+    if (cache->count > 0)
+    {
+        obj = cache->objs[--cache->count];
+        ++cache->allocs;
+        cache->requestedBytes += requested;
+        cache->grantedBytes += classSizes[classIdx];
+    }
+    portEXIT_CRITICAL(&cacheLock[core]);
+
+    return obj;
+}
+
+// Allocate without falling back on trimming or the callback. On failure, *result says why.
+static void *try_alloc(size_t size, alloc_result_t *result)
+{
+    int classIdx = size_to_class(size);
+
+    *result = ALLOC_OK;
+
+    if (classIdx < 0)
+    {
+        void *ptr = heap_alloc_aligned(size);
+        if (ptr != NULL)
+        {
+            portENTER_CRITICAL(&depotLock);
+            ++largeInUse;
+            portEXIT_CRITICAL(&depotLock);
+        }
+        else
+        {
+            *result = ALLOC_NO_HEAP;
+        }
+        return ptr;
+    }
+
+    // A new slab can be emptied by the other core before we get to it, so keep growing until we get an object
+    // or the heap or slab table runs out. Every slab grown is one step closer to the latter.
+    while (1)
+    {
+        void *obj = cache_pop(classIdx, size);
+        if (obj != NULL)
+            return obj;
+
+        *result = slab_grow(classIdx);
+        if (*result != ALLOC_OK)
+            return NULL;
+    }
+}
+
+void *slab_malloc(size_t size)
+{
+    if (size == 0)
+        return NULL;
+
+    alloc_result_t result;
+    void *ptr = try_alloc(size, &result);
+
+    if (ptr == NULL && result == ALLOC_NO_HEAP)
+    {
+        // Empty slabs and objects parked in the caches may give the heap enough back. Not when the slab limit
+        // was hit: flushing every core's caches then only costs them their contents.
+        slab_trim();
+        ptr = try_alloc(size, &result);
+    }
+
+    // The callback frees memory or blocks until some is freed before asking for another attempt
+    while (ptr == NULL && oomCallback != NULL && oomCallback(size, oomCallbackArg))
+        ptr = try_alloc(size, &result);
+
+    if (ptr == NULL)
+    {
+        int classIdx = size_to_class(size);
+
+        portENTER_CRITICAL(&depotLock);
+        if (classIdx < 0)
+            ++largeFailures;
+        else
+            ++classes[classIdx].failures;
+        portEXIT_CRITICAL(&depotLock);
+    }
+
+    return ptr;
+}
+
+void *slab_calloc(size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size)
+        return NULL;
+
+    void *ptr = slab_malloc(n * size);
+    if (ptr != NULL)
+        memset(ptr, 0, n * size);
+
+    return ptr;
+}
+
+void slab_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    slab_t *slab = slab_of(ptr);
+
+    if (slab == NULL)
+    {
+        portENTER_CRITICAL(&depotLock);
+        --largeInUse;
+        portEXIT_CRITICAL(&depotLock);
+        heap_free_aligned(ptr);
+        return;
+    }
+
+    int core = xPortGetCoreID();
+    core_cache_t *cache = &caches[core][slab->classIdx];
+    slab_t *release = NULL;
+
+    portENTER_CRITICAL(&cacheLock[core]);
+    if (cache->count == CACHE_SIZE)
+    {
+        portENTER_CRITICAL(&depotLock);
+        depot_put(cache->objs, CACHE_BATCH, &release);          // the oldest ones, keep the recently used local
+        portEXIT_CRITICAL(&depotLock);
+        cache->count -= CACHE_BATCH;
+        memmove(cache->objs, &cache->objs[CACHE_BATCH], cache->count * sizeof(cache->objs[0]));
+    }
+
+    cache->objs[cache->count++] = ptr;
+    ++cache->frees;
+    portEXIT_CRITICAL(&cacheLock[core]);
+
+    release_slabs(release);
+}
+
+void slab_trim(void)
+{
+    slab_t *release = NULL;
+
+    for (int core = 0; core < portNUM_PROCESSORS; ++core)
+    {
+        portENTER_CRITICAL(&cacheLock[core]);
+        portENTER_CRITICAL(&depotLock);
+        for (int c = 0; c < SLAB_NUM_CLASSES; ++c)
+        {
+            depot_put(caches[core][c].objs, caches[core][c].count, &release);
+            caches[core][c].count = 0;
+        }
+        portEXIT_CRITICAL(&depotLock);
+        portEXIT_CRITICAL(&cacheLock[core]);
+    }
+
+    // depot_put() keeps up to CONFIG_SLAB_ALLOC_MAX_EMPTY_SLABS per class, trimming drops those as well
+    portENTER_CRITICAL(&depotLock);
+    for (int c = 0; c < SLAB_NUM_CLASSES; ++c)
+    {
+        slab_class_t *cls = &classes[c];
+        slab_t *slab = cls->partial;
+
+        while (slab != NULL)
+        {
+            slab_t *next = slab->next;
+
+            if (slab->used == 0)
+                slab_retire(cls, slab, &release);
+            slab = next;
+        }
+    }
+    portEXIT_CRITICAL(&depotLock);
+
+    release_slabs(release);
+}
+
+void slab_set_oom_callback(slab_oom_cb_t callback, void *arg)
+{
+    portENTER_CRITICAL(&depotLock);
+    oomCallback = callback;
+    oomCallbackArg = arg;
+    portEXIT_CRITICAL(&depotLock);
+}
+
+void slab_get_stats(slab_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    uint64_t requested[SLAB_NUM_CLASSES] = { 0 };
+    uint64_t granted[SLAB_NUM_CLASSES] = { 0 };
+    uint32_t liveBytes = 0;
+
+    // Take every lock so the numbers add up
+    for (int core = 0; core < portNUM_PROCESSORS; ++core)
+        portENTER_CRITICAL(&cacheLock[core]);
+    portENTER_CRITICAL(&depotLock);
+
+    for (int c = 0; c < SLAB_NUM_CLASSES; ++c)
+    {
+        slab_class_stats_t *out = &stats->classes[c];
+
+        out->object_size = classSizes[c];
+        out->slabs = classes[c].slabs;
+        out->objects_total = classes[c].slabs * ((SLAB_SIZE - SLAB_HEADER_SIZE) / classSizes[c]);
+        out->failures = classes[c].failures;
+
+        for (int core = 0; core < portNUM_PROCESSORS; ++core)
+        {
+            out->objects_cached += caches[core][c].count;
+            out->allocs += caches[core][c].allocs;
+            out->frees += caches[core][c].frees;
+            requested[c] += caches[core][c].requestedBytes;
+            granted[c] += caches[core][c].grantedBytes;
+        }
+
+        out->objects_in_use = classes[c].used - out->objects_cached;
+        liveBytes += out->objects_in_use * classSizes[c];
+        stats->slabs += classes[c].slabs;
+    }
+
+    stats->large_in_use = largeInUse;
+    stats->large_failures = largeFailures;
+
+    portEXIT_CRITICAL(&depotLock);
+    for (int core = portNUM_PROCESSORS - 1; core >= 0; --core)
+        portEXIT_CRITICAL(&cacheLock[core]);
+
+    for (int c = 0; c < SLAB_NUM_CLASSES; ++c)
+    {
+        if (granted[c] > 0)
+            stats->classes[c].waste = 1.0f - (float)requested[c] / (float)granted[c];
+    }
+
+    stats->slab_bytes = (size_t)stats->slabs * SLAB_SIZE;
+    if (stats->slab_bytes > 0)
+        stats->slab_fragmentation = 1.0f - (float)liveBytes / (float)stats->slab_bytes;
+
+#if !CONFIG_IDF_TARGET_LINUX
+    stats->heap_free = heap_caps_get_free_size(HEAP_CAPS);
+    stats->heap_largest_free_block = heap_caps_get_largest_free_block(HEAP_CAPS);
+    if (stats->heap_free > 0)
+        stats->heap_fragmentation = 1.0f - (float)stats->heap_largest_free_block / (float)stats->heap_free;
+#endif
+}
+
+void slab_print_stats(void)
+{
+    static slab_stats_t stats;          // too big for a small task stack
+
+    slab_get_stats(&stats);
+
+    ESP_LOGI(TAG, " size  slabs  total  in use  cached   allocs    frees  fails  waste");
+    for (int c = 0; c < SLAB_NUM_CLASSES; ++c)
+    {
+        const slab_class_stats_t *cls = &stats.classes[c];
+
+        if (cls->slabs == 0 && cls->allocs == 0 && cls->failures == 0)
+            continue;
+
+        ESP_LOGI(TAG, "%5u  %5u  %5u  %6u  %6u  %7u  %7u  %5u  %4.1f%%",
+                 (unsigned)cls->object_size, (unsigned)cls->slabs, (unsigned)cls->objects_total,
+                 (unsigned)cls->objects_in_use, (unsigned)cls->objects_cached, (unsigned)cls->allocs,
+                 (unsigned)cls->frees, (unsigned)cls->failures, cls->waste * 100.0f);
+    }
+
+    ESP_LOGI(TAG, "Slabs: %u (%u bytes), fragmentation %.1f%%. Large blocks in use: %u, failed: %u",
+             (unsigned)stats.slabs, (unsigned)stats.slab_bytes, stats.slab_fragmentation * 100.0f,
+             (unsigned)stats.large_in_use, (unsigned)stats.large_failures);
+#if !CONFIG_IDF_TARGET_LINUX
+    ESP_LOGI(TAG, "Heap: %u bytes free, largest free block %u, fragmentation %.1f%%",
+             (unsigned)stats.heap_free, (unsigned)stats.heap_largest_free_block, stats.heap_fragmentation * 100.0f);
+#endif
+}
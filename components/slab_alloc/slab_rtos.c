@@ -0,0 +1,154 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/message_buffer.h"
+#include "freertos/stream_buffer.h"
+#include "slab_alloc.h"
+#include "slab_rtos.h"
+
+// The handle returned by the xxxCreateStatic() functions is the address of the control block passed in, so the
+// control block and the storage behind it are allocated as one block and released through the handle.
+
+typedef struct {
+    StaticQueue_t queue;
+    uint8_t storage[];
+} slab_queue_t;
+
+typedef struct {
+    StaticStreamBuffer_t buffer;
+    uint8_t storage[];
+} slab_stream_buffer_t;
+
+// The TCB is allocated separately from the stack, so each lands in a size class that fits it closely
+typedef struct {
+    StaticTask_t tcb;
+    StackType_t *stack;
+} slab_task_t;
+
+
+QueueHandle_t slab_queue_create(UBaseType_t queueLength, UBaseType_t itemSize)
+{
+    slab_queue_t *block = slab_malloc(sizeof(slab_queue_t) + (size_t)queueLength * itemSize);
+    if (block == NULL)
+        return NULL;
+
+    QueueHandle_t queue = xQueueCreateStatic(queueLength, itemSize, itemSize > 0 ? block->storage : NULL, &block->queue);
+    if (queue == NULL)
+        slab_free(block);
+
+    return queue;
+}
+
+void slab_queue_delete(QueueHandle_t queue)
+{
+    if (queue == NULL)
+        return;
+
+    vQueueDelete(queue);
+    slab_free(queue);
+}
+
+// Stream and message buffers keep one byte of the storage unused, so one extra byte gives the full requested
+// capacity, as xStreamBufferCreate() does.
+static void *stream_buffer_alloc(size_t bufferSizeBytes)
+{
+    return slab_malloc(sizeof(slab_stream_buffer_t) + bufferSizeBytes + 1);
+}
+
+MessageBufferHandle_t slab_message_buffer_create(size_t bufferSizeBytes)
+{
+    slab_stream_buffer_t *block = stream_buffer_alloc(bufferSizeBytes);
+    if (block == NULL)
+        return NULL;
+
+    MessageBufferHandle_t messageBuffer = xMessageBufferCreateStatic(bufferSizeBytes + 1, block->storage, &block->buffer);
+    if (messageBuffer == NULL)
+        slab_free(block);
+
+    return messageBuffer;
+}
+
+void slab_message_buffer_delete(MessageBufferHandle_t messageBuffer)
+{
+    if (messageBuffer == NULL)
+        return;
+
+    vMessageBufferDelete(messageBuffer);
+    slab_free(messageBuffer);
+}
+
+StreamBufferHandle_t slab_stream_buffer_create(size_t bufferSizeBytes, size_t triggerLevelBytes)
+{
+    slab_stream_buffer_t *block = stream_buffer_alloc(bufferSizeBytes);
+    if (block == NULL)
+        return NULL;
+
+    StreamBufferHandle_t streamBuffer = xStreamBufferCreateStatic(bufferSizeBytes + 1, triggerLevelBytes, block->storage, &block->buffer);
+    if (streamBuffer == NULL)
+        slab_free(block);
+
+    return streamBuffer;
+}
+
+void slab_stream_buffer_delete(StreamBufferHandle_t streamBuffer)
+{
+    if (streamBuffer == NULL)
+        return;
+
+    vStreamBufferDelete(streamBuffer);
+    slab_free(streamBuffer);
+}
+
+BaseType_t slab_task_create_pinned_to_core(TaskFunction_t taskCode, const char *name, uint32_t stackDepth,
+                                           void *parameters, UBaseType_t priority, TaskHandle_t *createdTask,
+                                           BaseType_t coreId)
+{
+    slab_task_t *task = slab_malloc(sizeof(slab_task_t));
+    StackType_t *stack = slab_malloc(stackDepth * sizeof(StackType_t));
+
+    if (task == NULL || stack == NULL)
+    {
+        slab_free(task);
+        slab_free(stack);
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    task->stack = stack;
+
+    // The handle is &task->tcb, i.e. task itself
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(taskCode, name, stackDepth, parameters, priority, stack, &task->tcb, coreId);
+    if (handle == NULL)
+    {
+        slab_free(stack);
+        slab_free(task);
+        return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
+
+    configASSERT( handle == (TaskHandle_t)task );
+
+    if (createdTask != NULL)
+        *createdTask = handle;
+
+    return pdPASS;
+}
+
+void slab_task_delete(TaskHandle_t task)
+{
+    if (task == NULL)
+        return;
+
+    configASSERT( task != xTaskGetCurrentTaskHandle() );
+
+    // vTaskDelete() hands a task that is running on the other core to the idle task, which would still be using
+    // its stack after we release it. Suspend it first and wait until it is off that core.
+    vTaskSuspend(task);
+    while (eTaskGetState(task) == eRunning)
+        vTaskDelay(1);
+
+    slab_task_t *block = (slab_task_t *)task;
+    StackType_t *stack = block->stack;
+
+    vTaskDelete(task);
+    slab_free(stack);
+    slab_free(block);
+}
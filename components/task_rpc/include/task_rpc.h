@@ -0,0 +1,96 @@
+/*
+Request/response calls between tasks.
+
+A server is a task that runs a handler for every request it receives. A client belongs to one task and can
+have up to CONFIG_TASK_RPC_MAX_OUTSTANDING requests in flight. Requests go to the server through a queue
+of pointers (the payload is not copied again), and completion comes back as a direct-to-task notification:
+every outstanding request owns one bit of the client task's notification value, and its status and result
+pointer are left in the request itself. One wake-up can collect several completions.
+
+    task_rpc_server_create(&config, &server);
+    task_rpc_client_create(server, &client);        // from the task that will make the calls
+
+    // one call at a time
+    err = task_rpc_call(client, OP_READ, &arg, sizeof(arg), pdMS_TO_TICKS(100), &result);
+
+    // or pipelined
+    task_rpc_send(client, OP_READ, &arg, sizeof(arg), &id1);
+    task_rpc_send(client, OP_READ, &arg, sizeof(arg), &id2);
+    err = task_rpc_wait(client, id1, pdMS_TO_TICKS(100), &result);
+    err = task_rpc_wait_any(client, pdMS_TO_TICKS(100), &id, &result);
+
+A request whose wait times out is abandoned: if the server has not started it yet it is dropped, otherwise its
+result is thrown away when the handler returns.
+
+Client functions must be called from the task that created the client.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct task_rpc_server *task_rpc_server_t;
+typedef struct task_rpc_client *task_rpc_client_t;
+
+// Runs in the server task for every request. payload is the copy made by task_rpc_send(). Whatever is stored
+// in *result is handed to the client with the returned status.
+typedef esp_err_t (*task_rpc_handler_t)(uint32_t op, const void *payload, size_t payloadLen, void **result, void *ctx);
+
+typedef struct {
+    task_rpc_handler_t handler;
+    void *ctx;                      // passed to the handler
+    const char *name;               // server task name
+    uint32_t stackSize;
+    UBaseType_t priority;
+    BaseType_t coreId;              // or tskNO_AFFINITY
+    UBaseType_t queueLength;        // requests waiting for the server, from all clients
+} task_rpc_server_config_t;
+
+#define TASK_RPC_SERVER_CONFIG_DEFAULT() {  \
+    .handler = NULL,                        \
+    .ctx = NULL,                            \
+    .name = "task_rpc",                     \
+    .stackSize = 2048,                      \
+    .priority = tskIDLE_PRIORITY + 1,       \
+    .coreId = tskNO_AFFINITY,               \
+    .queueLength = 16,                      \
+}
+
+esp_err_t task_rpc_server_create(const task_rpc_server_config_t *config, task_rpc_server_t *server);
+
+// Stop the server task and free it. Delete its clients first.
+void task_rpc_server_delete(task_rpc_server_t server);
+
+// Create a client for the calling task.
+esp_err_t task_rpc_client_create(task_rpc_server_t server, task_rpc_client_t *client);
+
+// Abandon everything still outstanding, wait for the server to let go of it, and free the client.
+void task_rpc_client_delete(task_rpc_client_t client);
+
+// Queue a request without waiting for it. Returns ESP_ERR_NO_MEM if all request slots are in use, and
+// ESP_ERR_TIMEOUT if the server's queue is full.
+esp_err_t task_rpc_send(task_rpc_client_t client, uint32_t op, const void *payload, size_t payloadLen, uint32_t *requestId);
+
+// Wait for one request. Returns the handler's status, ESP_ERR_TIMEOUT (the request is abandoned), or
+// ESP_ERR_NOT_FOUND if requestId is not outstanding.
+esp_err_t task_rpc_wait(task_rpc_client_t client, uint32_t requestId, TickType_t timeout, void **result);
+
+// Wait for whichever outstanding request completes first. On ESP_ERR_TIMEOUT nothing is abandoned.
+esp_err_t task_rpc_wait_any(task_rpc_client_t client, TickType_t timeout, uint32_t *requestId, void **result);
+
+// task_rpc_send() followed by task_rpc_wait(). If the server's queue is full, waits for room in it, and that time
+// counts against timeout.
+esp_err_t task_rpc_call(task_rpc_client_t client, uint32_t op, const void *payload, size_t payloadLen,
+                        TickType_t timeout, void **result);
+
+#ifdef __cplusplus
+}
+#endif
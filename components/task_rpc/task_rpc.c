@@ -0,0 +1,476 @@
+/*
+Task RPC.
+
+Each client has CONFIG_TASK_RPC_MAX_OUTSTANDING request slots. A request lives in its slot from
+task_rpc_send() until the client collects the result, and the server's queue only carries pointers to slots.
+The slot state is the single source of truth and is only changed with the client's lock held:
+
+    FREE -> PENDING          task_rpc_send()
+    PENDING -> RUNNING       server picks it up
+    RUNNING -> DONE          handler returned, client notified (bit = slot index)
+    DONE -> FREE             client collected the result
+    PENDING/RUNNING -> ABANDONED    client timed out
+    ABANDONED -> FREE        server picks it up (not run) or its handler returns (result dropped)
+
+The server notifies the client after it has set the slot DONE and let go of the lock, so the client can collect
+the result before the notification is sent. The client's notifying count covers that window:
+task_rpc_client_delete() waits for it to drop to zero before freeing the client.
+
+Every DONE transition is followed by a notification that sets the slot's bit. The client adds the bits it
+receives to its completed mask and goes straight to those slots, checking each one's state before collecting it.
+That way a bit for an abandoned or already collected request is simply dropped, and a completion that arrives
+between the state check and xTaskNotifyWait() is not lost, as the wait then returns straight away.
+
+The notification value is not ours alone: stream and message buffers wait on index 0 too, and their wait clears
+the pending state but leaves the value. So the client takes bits that are already set before it blocks, and
+only blocks if there are none.
+*/
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "slab_alloc.h"
+#include "slab_rtos.h"
+#include "task_rpc.h"
+
+#define MAX_OUTSTANDING     CONFIG_TASK_RPC_MAX_OUTSTANDING
+#define NOTIFY_INDEX        CONFIG_TASK_RPC_NOTIFY_INDEX
+#define SLOT_BITS           5                               // low bits of a request id are the slot index
+#define SLOT_MASK           ((1u << SLOT_BITS) - 1)
+
+_Static_assert(MAX_OUTSTANDING <= 32, "every outstanding request needs a bit of the notification value");
+_Static_assert(NOTIFY_INDEX < configTASK_NOTIFICATION_ARRAY_ENTRIES,
+               "CONFIG_TASK_RPC_NOTIFY_INDEX must be below CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES");
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_PENDING,
+    SLOT_RUNNING,
+    SLOT_DONE,
+    SLOT_ABANDONED,
+} slot_state_t;
+
+typedef struct {
+    task_rpc_client_t client;
+    uint32_t id;
+    uint32_t op;
+    slot_state_t state;
+    esp_err_t status;
+    void *result;
+    size_t payloadLen;
+    uint8_t payload[CONFIG_TASK_RPC_MAX_PAYLOAD > 0 ? CONFIG_TASK_RPC_MAX_PAYLOAD : 1];
+} rpc_slot_t;
+
+struct task_rpc_client {
+    task_rpc_server_t server;
+    TaskHandle_t owner;
+    portMUX_TYPE lock;
+    uint32_t nextSeq;
+    uint32_t outstanding;               // slots sent and not yet collected or abandoned, owner task only
+    uint32_t completed;                 // notification bits received and not yet looked at, owner task only
+    uint32_t notifying;                 // completions the server has yet to signal, under the lock
+    rpc_slot_t slots[MAX_OUTSTANDING];
+};
+
+struct task_rpc_server {
+    task_rpc_server_config_t config;
+    QueueHandle_t queue;                // rpc_slot_t *, NULL asks the server to stop
+    TaskHandle_t task;
+};
+
+static const char* TAG = "task_rpc";
+
+
+static void server_task(void *pvParameters)
+{
+    task_rpc_server_t server = (task_rpc_server_t)pvParameters;
+    rpc_slot_t *slot;
+
+    while (xQueueReceive(server->queue, &slot, portMAX_DELAY) == pdTRUE && slot != NULL)
+    {
+        task_rpc_client_t client = slot->client;
+
+        portENTER_CRITICAL(&client->lock);
+        bool run = slot->state == SLOT_PENDING;
+        slot->state = run ? SLOT_RUNNING : SLOT_FREE;       // abandoned before we got to it
+        portEXIT_CRITICAL(&client->lock);
+
+        if (!run)
+            continue;
+
+        void *result = NULL;
+        esp_err_t status = server->config.handler(slot->op, slot->payload, slot->payloadLen, &result, server->config.ctx);
+
+        // Once the slot is DONE the client may collect it and free itself, so read what the notification needs first
+        TaskHandle_t owner = client->owner;
+        uint32_t slotBit = 1u << (slot - client->slots);
+
+        portENTER_CRITICAL(&client->lock);
+        bool notify = slot->state == SLOT_RUNNING;
+        if (notify)
+        {
+            slot->status = status;
+            slot->result = result;
+            slot->state = SLOT_DONE;
+            ++client->notifying;
+        }
+        else
+        {
+            slot->state = SLOT_FREE;                        // abandoned while running, drop the result
+        }
+        portEXIT_CRITICAL(&client->lock);
+
+        if (notify)
+        {
+            xTaskNotifyIndexed(owner, NOTIFY_INDEX, slotBit, eSetBits);
+
+            portENTER_CRITICAL(&client->lock);
+            --client->notifying;
+            portEXIT_CRITICAL(&client->lock);
+        }
+    }
+
+    // task_rpc_server_delete() waits for this, then deletes the task
+    while (1)
+        vTaskSuspend(NULL);
+}
+
+esp_err_t task_rpc_server_create(const task_rpc_server_config_t *config, task_rpc_server_t *server)
+{
+    if (config == NULL || config->handler == NULL || server == NULL || config->queueLength == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    task_rpc_server_t newServer = slab_calloc(1, sizeof(struct task_rpc_server));
+    if (newServer == NULL)
+        return ESP_ERR_NO_MEM;
+
+    newServer->config = *config;
+    newServer->queue = slab_queue_create(config->queueLength, sizeof(rpc_slot_t *));
+    if (newServer->queue == NULL)
+    {
+        slab_free(newServer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (slab_task_create_pinned_to_core(server_task, config->name, config->stackSize, newServer, config->priority,
+                                        &newServer->task, config->coreId) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Could not create the server task %s.", config->name);
+        slab_queue_delete(newServer->queue);
+        slab_free(newServer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *server = newServer;
+    return ESP_OK;
+}
+
+void task_rpc_server_delete(task_rpc_server_t server)
+{
+    if (server == NULL)
+        return;
+
+    rpc_slot_t *stop = NULL;
+    xQueueSend(server->queue, &stop, portMAX_DELAY);
+
+    while (eTaskGetState(server->task) != eSuspended)
+        vTaskDelay(1);
+
+    slab_task_delete(server->task);
+    slab_queue_delete(server->queue);
+    slab_free(server);
+}
+
+esp_err_t task_rpc_client_create(task_rpc_server_t server, task_rpc_client_t *client)
+{
+    if (server == NULL || client == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    task_rpc_client_t newClient = slab_calloc(1, sizeof(struct task_rpc_client));
+    if (newClient == NULL)
+        return ESP_ERR_NO_MEM;
+
+    newClient->server = server;
+    newClient->owner = xTaskGetCurrentTaskHandle();
+    portMUX_INITIALIZE(&newClient->lock);
+
+    for (int i = 0; i < MAX_OUTSTANDING; ++i)
+        newClient->slots[i].client = newClient;
+
+    *client = newClient;
+    return ESP_OK;
+}
+
+void task_rpc_client_delete(task_rpc_client_t client)
+{
+    if (client == NULL)
+        return;
+
+    configASSERT( client->owner == xTaskGetCurrentTaskHandle() );
+
+    portENTER_CRITICAL(&client->lock);
+    for (int i = 0; i < MAX_OUTSTANDING; ++i)
+    {
+        rpc_slot_t *slot = &client->slots[i];
+
+        if (slot->state == SLOT_PENDING || slot->state == SLOT_RUNNING)
+            slot->state = SLOT_ABANDONED;
+        else if (slot->state == SLOT_DONE)
+            slot->state = SLOT_FREE;
+    }
+    portEXIT_CRITICAL(&client->lock);
+
+    // Abandoned slots are still referenced by the server (queue or handler) until it sets them free, and a
+    // completion we have already collected may not have been notified yet
+    while (1)
+    {
+        portENTER_CRITICAL(&client->lock);
+        bool released = client->notifying == 0;
+        for (int i = 0; i < MAX_OUTSTANDING; ++i)
+            released = released && client->slots[i].state == SLOT_FREE;
+        portEXIT_CRITICAL(&client->lock);
+
+        if (released)
+            break;
+        vTaskDelay(1);
+    }
+
+    xTaskNotifyStateClearIndexed(NULL, NOTIFY_INDEX);
+    ulTaskNotifyValueClearIndexed(NULL, NOTIFY_INDEX, UINT32_MAX);
+    slab_free(client);
+}
+
+// Put a request in a free slot and queue it, waiting up to queueTimeout for room in the server's queue
+static esp_err_t send_request(task_rpc_client_t client, uint32_t op, const void *payload, size_t payloadLen,
+                              TickType_t queueTimeout, uint32_t *requestId)
+{
+    if (client == NULL || requestId == NULL || (payload == NULL && payloadLen > 0))
+        return ESP_ERR_INVALID_ARG;
+
+    if (payloadLen > CONFIG_TASK_RPC_MAX_PAYLOAD)
+        return ESP_ERR_INVALID_SIZE;
+
+    configASSERT( client->owner == xTaskGetCurrentTaskHandle() );
+
+    rpc_slot_t *slot = NULL;
+
+    portENTER_CRITICAL(&client->lock);
+    for (int i = 0; i < MAX_OUTSTANDING; ++i)
+    {
+        if (client->slots[i].state == SLOT_FREE)
+        {
+            slot = &client->slots[i];
+
+            // The sequence number tells a new request from an earlier one that used the same slot
+            client->nextSeq = (client->nextSeq + 1) & (UINT32_MAX >> SLOT_BITS);
+            if (client->nextSeq == 0)
+                client->nextSeq = 1;
+
+            slot->id = (client->nextSeq << SLOT_BITS) | i;
+            slot->state = SLOT_PENDING;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&client->lock);
+
+    if (slot == NULL)
+        return ESP_ERR_NO_MEM;
+
+    // The server does not look at the slot before it comes out of the queue
+    slot->op = op;
+    slot->payloadLen = payloadLen;
+    if (payloadLen > 0)
+        memcpy(slot->payload, payload, payloadLen);
+
+    if (xQueueSend(client->server->queue, &slot, queueTimeout) != pdTRUE)
+    {
+        portENTER_CRITICAL(&client->lock);
+        slot->state = SLOT_FREE;
+        portEXIT_CRITICAL(&client->lock);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    client->outstanding |= 1u << (slot - client->slots);
+    *requestId = slot->id;
+    return ESP_OK;
+}
+
+esp_err_t task_rpc_send(task_rpc_client_t client, uint32_t op, const void *payload, size_t payloadLen, uint32_t *requestId)
+{
+    return send_request(client, op, payload, payloadLen, 0, requestId);
+}
+
+// Take the result out of a DONE slot. Call with the client's lock held.
+static esp_err_t collect(task_rpc_client_t client, rpc_slot_t *slot, void **result)
+{
+    uint32_t slotBit = 1u << (slot - client->slots);
+
+    if (result != NULL)
+        *result = slot->result;
+
+    client->outstanding &= ~slotBit;
+    client->completed &= ~slotBit;
+    slot->state = SLOT_FREE;
+    return slot->status;
+}
+
+// Block until a completion is signalled or the time since start reaches timeout, and add the slots signalled to
+// client->completed. Returns false on timeout.
+static bool wait_notification(task_rpc_client_t client, TickType_t start, TickType_t timeout)
+{
+    // Bits left behind by a wait that cleared the pending state, e.g. a message buffer receive on this index
+    uint32_t bits = ulTaskNotifyValueClearIndexed(NULL, NOTIFY_INDEX, UINT32_MAX);
+    if (bits != 0)
+    {
+        client->completed |= bits;
+        return true;
+    }
+
+    TickType_t remaining = portMAX_DELAY;
+
+    if (timeout != portMAX_DELAY)
+    {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+            return false;
+
+        remaining = timeout - elapsed;
+    }
+
+    if (xTaskNotifyWaitIndexed(NOTIFY_INDEX, 0, UINT32_MAX, &bits, remaining) == pdTRUE)
+        client->completed |= bits;
+
+    return true;
+}
+
+esp_err_t task_rpc_wait(task_rpc_client_t client, uint32_t requestId, TickType_t timeout, void **result)
+{
+    if (client == NULL || (requestId & SLOT_MASK) >= MAX_OUTSTANDING)
+        return ESP_ERR_INVALID_ARG;
+
+    configASSERT( client->owner == xTaskGetCurrentTaskHandle() );
+
+    rpc_slot_t *slot = &client->slots[requestId & SLOT_MASK];
+    TickType_t start = xTaskGetTickCount();
+
+    while (1)
+    {
+        esp_err_t err = ESP_ERR_TIMEOUT;
+        bool finished = true;
+
+        portENTER_CRITICAL(&client->lock);
+        if (slot->id != requestId || slot->state == SLOT_FREE || slot->state == SLOT_ABANDONED)
+            err = ESP_ERR_NOT_FOUND;
+        else if (slot->state == SLOT_DONE)
+            err = collect(client, slot, result);
+        else
+            finished = false;
+        portEXIT_CRITICAL(&client->lock);
+
+        if (finished)
+            return err;
+
+        if (!wait_notification(client, start, timeout))
+            break;
+    }
+
+    // Timed out. The server may have finished in the meantime, otherwise give the request up.
+    esp_err_t err = ESP_ERR_TIMEOUT;
+
+    portENTER_CRITICAL(&client->lock);
+    if (slot->state == SLOT_DONE)
+    {
+        err = collect(client, slot, result);
+    }
+    else
+    {
+        slot->state = SLOT_ABANDONED;
+        client->outstanding &= ~(1u << (slot - client->slots));
+    }
+    portEXIT_CRITICAL(&client->lock);
+
+    return err;
+}
+
+esp_err_t task_rpc_wait_any(task_rpc_client_t client, TickType_t timeout, uint32_t *requestId, void **result)
+{
+    if (client == NULL || requestId == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    configASSERT( client->owner == xTaskGetCurrentTaskHandle() );
+
+    TickType_t start = xTaskGetTickCount();
+
+    do
+    {
+        // Only the slots signalled since we last looked can have completed. Stale bits are dropped on the way.
+        while (client->completed != 0)
+        {
+            int i = __builtin_ctz(client->completed);
+            rpc_slot_t *slot = &client->slots[i];
+            bool found = false;
+            esp_err_t err = ESP_OK;
+
+            client->completed &= ~(1u << i);
+
+            portENTER_CRITICAL(&client->lock);
+            if (slot->state == SLOT_DONE)
+            {
+                *requestId = slot->id;
+                err = collect(client, slot, result);
+                found = true;
+            }
+            portEXIT_CRITICAL(&client->lock);
+
+            if (found)
+                return err;
+        }
+
+        if (client->outstanding == 0)
+            return ESP_ERR_NOT_FOUND;
+
+    } while (wait_notification(client, start, timeout));
+
+    // Timed out. Look at every outstanding slot once more, in case a completion's bit went astray.
+    esp_err_t err = ESP_ERR_TIMEOUT;
+
+    portENTER_CRITICAL(&client->lock);
+    for (int i = 0; i < MAX_OUTSTANDING; ++i)
+    {
+        rpc_slot_t *slot = &client->slots[i];
+
+        if ((client->outstanding & (1u << i)) && slot->state == SLOT_DONE)
+        {
+            *requestId = slot->id;
+            err = collect(client, slot, result);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&client->lock);
+
+    return err;
+}
+
+esp_err_t task_rpc_call(task_rpc_client_t client, uint32_t op, const void *payload, size_t payloadLen,
+                        TickType_t timeout, void **result)
+{
+    uint32_t requestId;
+    TickType_t start = xTaskGetTickCount();
+    esp_err_t err = send_request(client, op, payload, payloadLen, timeout, &requestId);
+
+    if (err != ESP_OK)
+        return err;
+
+    // The time spent waiting for room in the queue counts against the timeout
+    if (timeout != portMAX_DELAY)
+    {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        timeout = elapsed < timeout ? timeout - elapsed : 0;
+    }
+
+    return task_rpc_wait(client, requestId, timeout, result);
+}
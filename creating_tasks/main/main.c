@@ -4,6 +4,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
+#include "slab_rtos.h"
 
 #define STACK_SIZE  2048    //Task stack size
 #define BLINK_GPIO 2        // GPIO pin mapped to the led in esp32
@@ -21,7 +22,9 @@ static void configure_led(void)
 void on_led(void* pvParameters)
 {
     gpio_set_level(BLINK_GPIO, 1);          // turn on the led
-    while (1) {}
+    while (1) {
+        vTaskDelay(portMAX_DELAY);
+    }
 
 }
 
@@ -29,7 +32,9 @@ void on_led(void* pvParameters)
 void off_led(void* pvParameters)
 {
     gpio_set_level(BLINK_GPIO, 0);          // turn of the led
-    while (1) {}
+    while (1) {
+        vTaskDelay(portMAX_DELAY);
+    }
 
 }
 
@@ -46,7 +51,11 @@ TaskHandle_t create_task (void (*task_to_run)())
     
     // This function is similar to xTaskCreate (used for single core controllers), but allows setting task affinity in SMP (Symmetric Multiprocessing) system.
     // This task will be pinned to core 0 (last parameter). If you don't want to specify the affinity pass tskNO_AFFINITY in the last parameter.
-    xTaskCreatePinnedToCore (task_to_run, "On Led", STACK_SIZE, &ucParameterToPass, tskIDLE_PRIORITY, &xHandle, 0);
+
+    // The task is created and deleted every 5 seconds, so its stack and TCB come from the slab allocator
+    // (same parameters as xTaskCreatePinnedToCore). Each cycle reuses the same slab memory instead of
+    // leaving holes in the heap.
+    slab_task_create_pinned_to_core (task_to_run, "On Led", STACK_SIZE, &ucParameterToPass, tskIDLE_PRIORITY, &xHandle, 0);
     configASSERT( xHandle );
 
     return xHandle;
@@ -68,7 +77,7 @@ void app_main(void)
 
         if( xHandle != NULL )
         {
-            vTaskDelete( xHandle );
+            slab_task_delete( xHandle );          // deletes the task and gives its stack and TCB back to the slab allocator
             xHandle = NULL;
         }
 
@@ -79,7 +88,7 @@ void app_main(void)
 
         if( xHandle != NULL )
         {
-            vTaskDelete( xHandle );
+            slab_task_delete( xHandle );          // deletes the task and gives its stack and TCB back to the slab allocator
             xHandle = NULL;
         }
     }
@@ -0,0 +1,59 @@
+/*
+Regression check for the host simulator (linux target only).
+
+With CONFIG_SIM_RUN_TIME_S set (see sdkconfig.defaults.linux), the simulator stops after that much virtual time
+and calls sim_run_finished(). This checks that the LED on BLINK_GPIO was switched on, off, on, ... exactly every
+5 s for the whole run, and returns a non-zero exit status if not:
+
+    idf.py --preview set-target linux
+    idf.py build && ./build/main.elf; echo $?
+*/
+
+#include <inttypes.h>
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "sim_time.h"
+
+#define BLINK_GPIO      2
+#define PERIOD_MS       5000
+
+static const char* TAG = "sim_check";
+
+static sim_gpio_event_t events[CONFIG_SIM_GPIO_TRACE_LEN];
+
+int sim_run_finished(void)
+{
+    size_t count = sim_gpio_get_trace(events, CONFIG_SIM_GPIO_TRACE_LEN);
+    size_t expected = (size_t)CONFIG_SIM_RUN_TIME_S * 1000 / PERIOD_MS;
+
+    if (expected > CONFIG_SIM_GPIO_TRACE_LEN)
+        expected = CONFIG_SIM_GPIO_TRACE_LEN;
+
+    if (count < expected)
+    {
+        ESP_LOGE(TAG, "FAIL: %u LED changes, expected at least %u", (unsigned)count, (unsigned)expected);
+        return 1;
+    }
+
+    // Once the trace is full it only holds the latest changes, so number them from the first one kept
+    uint64_t first = events[0].time_ms / PERIOD_MS;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t due = (first + i) * PERIOD_MS;
+        uint32_t level = (first + i) % 2 == 0 ? 1 : 0;
+
+        if (events[i].gpio_num != BLINK_GPIO || events[i].level != level ||
+            events[i].time_ms != due)
+        {
+            ESP_LOGE(TAG, "FAIL: change %u is GPIO %d -> %" PRIu32 " at %" PRIu64 " ms, expected GPIO %d -> %" PRIu32 " at %" PRIu64 " ms",
+                     (unsigned)i, events[i].gpio_num, events[i].level, events[i].time_ms, BLINK_GPIO, level, due);
+            return 1;
+        }
+    }
+
+    ESP_LOGI(TAG, "PASS: %u LED changes, %d ms apart", (unsigned)count, PERIOD_MS);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "sim_time.h"
+
+static const char* TAG = "sim_gpio";
+
+static gpio_mode_t modes[GPIO_NUM_MAX];
+static uint32_t levels[GPIO_NUM_MAX];
+
+static sim_gpio_event_t trace[CONFIG_SIM_GPIO_TRACE_LEN];
+static size_t traceHead = 0;            // next slot to write
+static size_t traceCount = 0;
+
+static bool valid_pin(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    modes[gpio_num] = GPIO_MODE_DISABLE;
+    levels[gpio_num] = 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    modes[gpio_num] = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    level = level ? 1 : 0;
+    uint64_t now = sim_time_now_ms();
+
+    // Writes to a pin that is not an output are ignored, like on the chip
+    if (modes[gpio_num] == GPIO_MODE_DISABLE || modes[gpio_num] == GPIO_MODE_INPUT)
+    {
+        ESP_LOGW(TAG, "%" PRIu64 " ms: GPIO %d is not an output, level %" PRIu32 " ignored", now, gpio_num, level);
+        return ESP_OK;
+    }
+
+    vTaskSuspendAll();          // the trace is shared by every task that drives a pin
+    levels[gpio_num] = level;
+    trace[traceHead] = (sim_gpio_event_t) { .time_ms = now, .gpio_num = gpio_num, .level = level };
+    traceHead = (traceHead + 1) % CONFIG_SIM_GPIO_TRACE_LEN;
+    if (traceCount < CONFIG_SIM_GPIO_TRACE_LEN)
+        ++traceCount;
+    xTaskResumeAll();
+
+    ESP_LOGI(TAG, "%" PRIu64 " ms: GPIO %d -> %" PRIu32, now, gpio_num, level);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return 0;
+
+    return levels[gpio_num];
+}
+
+size_t sim_gpio_get_trace(sim_gpio_event_t* events, size_t maxEvents)
+{
+    vTaskSuspendAll();
+
+    size_t count = traceCount < maxEvents ? traceCount : maxEvents;
+    size_t first = (traceHead + CONFIG_SIM_GPIO_TRACE_LEN - count) % CONFIG_SIM_GPIO_TRACE_LEN;
+
+    for (size_t i = 0; i < count; ++i)
+        events[i] = trace[(first + i) % CONFIG_SIM_GPIO_TRACE_LEN];
+
+    xTaskResumeAll();
+    return count;
+}
@@ -0,0 +1,48 @@
+/*
+Host simulator stand-in for ESP-IDF's driver/gpio.h.
+
+Only the calls used by the examples are provided. Output levels are kept in memory and every change is
+recorded with its (virtual) timestamp, see sim_gpio_get_trace().
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_NUM_MAX 40
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+    GPIO_MODE_OUTPUT_OD,
+    GPIO_MODE_INPUT_OUTPUT_OD,
+    GPIO_MODE_INPUT_OUTPUT,
+} gpio_mode_t;
+
+// One recorded level change
+typedef struct {
+    uint64_t time_ms;       // virtual time of the change
+    gpio_num_t gpio_num;
+    uint32_t level;
+} sim_gpio_event_t;
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+
+// Copy up to maxEvents of the most recent level changes, oldest first, into events. Returns the number copied.
+size_t sim_gpio_get_trace(sim_gpio_event_t* events, size_t maxEvents);
+
+#ifdef __cplusplus
+}
+#endif
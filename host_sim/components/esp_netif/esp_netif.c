@@ -0,0 +1,78 @@
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "esp_netif.h"
+#include "esp_log.h"
+
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+static const char* TAG = "sim_netif";
+
+struct esp_netif_obj {
+    const char *if_key;
+    bool created;
+    esp_netif_ip_info_t ip_info;
+};
+
+static struct esp_netif_obj staNetif = { .if_key = "WIFI_STA_DEF" };
+
+static void ip_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == IP_EVENT_STA_GOT_IP)
+    {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        staNetif.ip_info = event->ip_info;
+    }
+    else if (event_id == IP_EVENT_STA_LOST_IP)
+    {
+        memset(&staNetif.ip_info, 0, sizeof(staNetif.ip_info));
+    }
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    if (staNetif.created)
+        return &staNetif;
+
+    // Needs the default event loop, same as on the chip
+    if (esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &ip_event_handler, NULL) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Create the default event loop before the station interface.");
+        return NULL;
+    }
+
+    staNetif.created = true;
+    return &staNetif;
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key)
+{
+    if (staNetif.created && if_key != NULL && strcmp(if_key, staNetif.if_key) == 0)
+        return &staNetif;
+
+    return NULL;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    if (esp_netif == NULL || ip_info == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    *ip_info = esp_netif->ip_info;
+    return ESP_OK;
+}
+
+uint32_t esp_ip4addr_aton(const char *addr)
+{
+    struct in_addr parsed;
+
+    if (addr == NULL || inet_pton(AF_INET, addr, &parsed) != 1)
+        return 0;
+
+    return parsed.s_addr;
+}
@@ -0,0 +1,209 @@
+#include <string.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+
+#define WIFI_REASON_ASSOC_LEAVE     8
+#define WIFI_REASON_BEACON_TIMEOUT  200
+#define EVENT_POST_TIMEOUT          pdMS_TO_TICKS(100)
+
+static const char* TAG = "sim_wifi";
+
+static bool initialized = false;
+static bool started = false;
+static bool connected = false;
+static wifi_mode_t wifiMode = WIFI_MODE_NULL;
+static wifi_config_t staConfig;
+
+static TimerHandle_t connectTimer = NULL;       // fires when the fake association completes
+static TimerHandle_t dropTimer = NULL;          // fires when the fake link is lost
+
+static uint8_t ssid_length(void)
+{
+    return strnlen((const char *)staConfig.sta.ssid, sizeof(staConfig.sta.ssid));
+}
+
+static void post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t event = { .ssid_len = ssid_length(), .reason = reason };
+    memcpy(event.ssid, staConfig.sta.ssid, sizeof(event.ssid));
+
+    connected = false;
+    esp_event_post(IP_EVENT, IP_EVENT_STA_LOST_IP, NULL, 0, EVENT_POST_TIMEOUT);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), EVENT_POST_TIMEOUT);
+}
+
+// Timer callback: the fake access point accepted us
+static void on_connect_timer(TimerHandle_t xTimer)
+{
+    wifi_event_sta_connected_t connectedEvent = { .ssid_len = ssid_length(), .channel = 1 };
+    memcpy(connectedEvent.ssid, staConfig.sta.ssid, sizeof(connectedEvent.ssid));
+
+    ip_event_got_ip_t ipEvent = {
+        .esp_netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"),
+        .ip_info = {
+            .ip = { esp_ip4addr_aton(CONFIG_SIM_WIFI_IP) },
+            .netmask = { esp_ip4addr_aton(CONFIG_SIM_WIFI_NETMASK) },
+            .gw = { esp_ip4addr_aton(CONFIG_SIM_WIFI_GW) },
+        },
+        .ip_changed = true,
+    };
+
+    connected = true;
+    ESP_LOGI(TAG, "Associated with \"%s\"", (const char *)connectedEvent.ssid);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &connectedEvent, sizeof(connectedEvent), EVENT_POST_TIMEOUT);
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &ipEvent, sizeof(ipEvent), EVENT_POST_TIMEOUT);
+
+    if (dropTimer != NULL)
+        xTimerStart(dropTimer, 0);
+}
+
+#if CONFIG_SIM_WIFI_DROP_PERIOD_S > 0
+// Timer callback: simulated link loss
+static void on_drop_timer(TimerHandle_t xTimer)
+{
+    ESP_LOGI(TAG, "Dropping the link");
+    post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+}
+#endif
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    if (config == NULL || config->magic != WIFI_INIT_CONFIG_MAGIC)
+        return ESP_ERR_INVALID_ARG;
+
+    if (initialized)
+        return ESP_OK;
+
+    connectTimer = xTimerCreate("sim_wifi_conn", pdMS_TO_TICKS(CONFIG_SIM_WIFI_CONNECT_MS), false, NULL, on_connect_timer);
+    if (connectTimer == NULL)
+        return ESP_ERR_NO_MEM;
+
+#if CONFIG_SIM_WIFI_DROP_PERIOD_S > 0
+    dropTimer = xTimerCreate("sim_wifi_drop", pdMS_TO_TICKS(CONFIG_SIM_WIFI_DROP_PERIOD_S * 1000), false, NULL, on_drop_timer);
+    if (dropTimer == NULL)
+    {
+        xTimerDelete(connectTimer, portMAX_DELAY);
+        connectTimer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    esp_wifi_stop();
+    xTimerDelete(connectTimer, portMAX_DELAY);
+    connectTimer = NULL;
+    if (dropTimer != NULL)
+    {
+        xTimerDelete(dropTimer, portMAX_DELAY);
+        dropTimer = NULL;
+    }
+
+    initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (mode != WIFI_MODE_NULL && mode != WIFI_MODE_STA)
+    {
+        ESP_LOGE(TAG, "Only station mode is simulated.");
+        return ESP_ERR_WIFI_MODE;
+    }
+
+    wifiMode = mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (interface != WIFI_IF_STA)
+        return ESP_ERR_WIFI_IF;
+
+    if (conf == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    staConfig = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (wifiMode != WIFI_MODE_STA)
+        return ESP_ERR_WIFI_MODE;
+
+    if (started)
+        return ESP_OK;
+
+    started = true;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, EVENT_POST_TIMEOUT);
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (!started)
+        return ESP_OK;
+
+    esp_wifi_disconnect();
+    started = false;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0, EVENT_POST_TIMEOUT);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (!started)
+        return ESP_ERR_WIFI_NOT_STARTED;
+
+    if (!connected && xTimerIsTimerActive(connectTimer) == pdFALSE)
+        xTimerStart(connectTimer, EVENT_POST_TIMEOUT);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+
+    if (!started)
+        return ESP_ERR_WIFI_NOT_STARTED;
+
+    xTimerStop(connectTimer, EVENT_POST_TIMEOUT);
+    if (dropTimer != NULL)
+        xTimerStop(dropTimer, EVENT_POST_TIMEOUT);
+
+    if (connected)
+        post_disconnected(WIFI_REASON_ASSOC_LEAVE);
+
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+/*
+Host simulator stand-in for ESP-IDF's esp_wifi.h.
+
+Station mode only. Nothing is sent over the air: esp_wifi_start() posts WIFI_EVENT_STA_START, and
+esp_wifi_connect() posts WIFI_EVENT_STA_CONNECTED and IP_EVENT_STA_GOT_IP after CONFIG_SIM_WIFI_CONNECT_MS
+of virtual time. With CONFIG_SIM_WIFI_DROP_PERIOD_S the link is dropped periodically to exercise reconnects.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_WIFI_NOT_INIT       (ESP_ERR_WIFI_BASE + 1)
+#define ESP_ERR_WIFI_NOT_STARTED    (ESP_ERR_WIFI_BASE + 2)
+#define ESP_ERR_WIFI_IF             (ESP_ERR_WIFI_BASE + 4)
+#define ESP_ERR_WIFI_MODE           (ESP_ERR_WIFI_BASE + 5)
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+typedef enum {
+    WIFI_EVENT_WIFI_READY = 0,
+    WIFI_EVENT_SCAN_DONE,
+    WIFI_EVENT_STA_START,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t password[64];
+} wifi_sta_config_t;
+
+typedef union {
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct {
+    int magic;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_MAGIC 0x1F2F3F4F
+#define WIFI_INIT_CONFIG_DEFAULT() { .magic = WIFI_INIT_CONFIG_MAGIC }
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t channel;
+} wifi_event_sta_connected_t;
+
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_deinit(void);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_stop(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+/*
+Host simulator stand-in for ESP-IDF's nvs_flash.h. There is no flash to initialise, every call succeeds.
+*/
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_deinit(void);
+esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
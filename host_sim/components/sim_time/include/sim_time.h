@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Current (virtual, when CONFIG_SIM_VIRTUAL_TIME is set) time since the scheduler started, in milliseconds.
+uint64_t sim_time_now_ms(void);
+
+// Called once CONFIG_SIM_RUN_TIME_S of virtual time have passed. The return value becomes the exit status of the
+// process, so an example can define this to check what happened during the run. The default returns 0.
+int sim_run_finished(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,105 @@
+/*
+Virtual clock for the host simulator.
+
+The FreeRTOS POSIX port drives the tick from a SIGALRM interval timer, so a vTaskDelay(5000) takes 5 real
+seconds. With CONFIG_SIM_VIRTUAL_TIME that timer is never armed, and the idle hook moves the tick count forward
+with xTaskCatchUpTicks() instead, but only once no other task is ready to run. Time is skipped exactly when
+nothing has anything to do, and tasks are woken on the same tick and in the same order as on the board.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "sim_time.h"
+
+static const char* TAG = "sim_time";
+
+uint64_t sim_time_now_ms(void)
+{
+    return (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+__attribute__((weak)) int sim_run_finished(void)
+{
+    return 0;
+}
+
+#if CONFIG_SIM_VIRTUAL_TIME
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY
+#error "CONFIG_SIM_VIRTUAL_TIME needs CONFIG_FREERTOS_USE_TRACE_FACILITY (see host_sim/sdkconfig.defaults)"
+#endif
+
+#define MAX_TASKS   32
+
+int __real_setitimer(int which, const struct itimerval* value, struct itimerval* oldValue);
+
+// The linker sends the port's setitimer() calls here (-Wl,--wrap, see CMakeLists.txt). The real-time tick is
+// never armed, so not even the startup code before the first idle pass sees a wall-clock tick.
+int __wrap_setitimer(int which, const struct itimerval* value, struct itimerval* oldValue)
+{
+    if (which != ITIMER_REAL)
+        return __real_setitimer(which, value, oldValue);
+
+    if (oldValue != NULL)
+        *oldValue = (struct itimerval){ 0 };
+
+    ESP_LOGI(TAG, "Virtual time enabled, real tick not started.");
+    return 0;
+}
+
+// True if a task other than the caller (the idle task) is ready to run.
+static bool others_ready(void)
+{
+    static TaskStatus_t tasks[MAX_TASKS];
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    UBaseType_t count = uxTaskGetSystemState(tasks, MAX_TASKS, NULL);
+
+    configASSERT(count > 0);                // more than MAX_TASKS tasks
+
+    for (UBaseType_t i = 0; i < count; ++i)
+    {
+        if (tasks[i].xHandle != self && tasks[i].eCurrentState == eReady)
+            return true;
+    }
+
+    return false;
+}
+#endif
+
+static void check_run_time(void)
+{
+#if CONFIG_SIM_RUN_TIME_S > 0
+    if (sim_time_now_ms() >= (uint64_t)CONFIG_SIM_RUN_TIME_S * 1000)
+    {
+        ESP_LOGI(TAG, "Reached %d s of simulated time. Exiting.", CONFIG_SIM_RUN_TIME_S);
+        int status = sim_run_finished();
+        fflush(stdout);
+        exit(status);
+    }
+#endif
+}
+
+void vApplicationIdleHook(void)
+{
+#if CONFIG_SIM_VIRTUAL_TIME
+    // Other tasks at idle priority share the cpu with this one; time stands still until they block
+    if (others_ready())
+        return;
+
+    // Tick until one wakes a task. Each step is an ordinary tick, so every task is woken on its own tick, and
+    // xTaskCatchUpTicks() reports the yield once something at or above idle priority is ready.
+    do
+    {
+        check_run_time();
+    }
+    while (xTaskCatchUpTicks(1) == pdFALSE);
+#endif
+
+    check_run_time();
+}
@@ -0,0 +1,21 @@
+# Host simulator for the example projects.
+#
+# Every example includes this file before project.cmake. On the esp32 target it does nothing. When the
+# project is built for the FreeRTOS POSIX port:
+#
+#   idf.py --preview set-target linux
+#   idf.py build monitor
+#
+# the mocked driver/gpio, esp_wifi, esp_netif and nvs_flash components in host_sim/components replace the
+# ESP-IDF ones, and sim_time adds the virtual clock (see host_sim/components/sim_time/Kconfig).
+
+if("${IDF_TARGET}" STREQUAL "linux" OR "$ENV{IDF_TARGET}" STREQUAL "linux")
+    list(APPEND EXTRA_COMPONENT_DIRS "${CMAKE_CURRENT_LIST_DIR}/components")
+    set(COMPONENTS main sim_time driver esp_wifi esp_netif nvs_flash)
+    list(APPEND SDKCONFIG_DEFAULTS "${CMAKE_CURRENT_LIST_DIR}/sdkconfig.defaults")
+
+    # Per-example simulator settings, e.g. a run time for an example that checks its own run
+    if(EXISTS "${CMAKE_CURRENT_SOURCE_DIR}/sdkconfig.defaults.linux")
+        list(APPEND SDKCONFIG_DEFAULTS "${CMAKE_CURRENT_SOURCE_DIR}/sdkconfig.defaults.linux")
+    endif()
+endif()
@@ -24,6 +24,7 @@ Stream Buffers:
 #include "freertos/task.h"
 #include "freertos/message_buffer.h"
 #include "esp_log.h"
+#include "slab_rtos.h"
 
 
 const static char* TAG = "MyModule";
@@ -60,7 +61,9 @@ void task(void)
     else
         ESP_LOGI(TAG, "TASK: Confirmation sent Successfully.");
 
-    while(1){}
+    while(1){
+        vTaskDelay(portMAX_DELAY);
+    }
 }
 
 
@@ -78,12 +81,14 @@ void app_main(void)
     
     // configSUPPORT_DYNAMIC_ALLOCATION in FreeRTOSConfig.h must be set to 1 or must be uninitialized for
     // xMessageBufferCreate method to become available.
+    // Here the buffer comes from the slab allocator instead (slab_message_buffer_create wraps xMessageBufferCreateStatic),
+    // which keeps the heap from fragmenting when buffers are created and deleted over and over.
 
     // size of the buffer in bytes - when a message is written to the buffer, length of the total bytes is also written at the end. Its 4 bytes 
     // on a 32-bit architecture, so on most 32-bit architectures a 10 byte message will take up 14 bytes of message buffer space.
 
     const size_t messageBufferSizeBytes = 104;   
-    messageBufferHandle = xMessageBufferCreate( messageBufferSizeBytes );
+    messageBufferHandle = slab_message_buffer_create( messageBufferSizeBytes );
 
     if (messageBufferHandle == NULL)        // buffer not created due to limited space
         return;
@@ -4,6 +4,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "slab_alloc.h"
+#include "slab_rtos.h"
 
 static const char *TAG = "example";                    // For Logging
 QueueHandle_t xQueue = NULL;                           // Queue Handle
@@ -20,7 +22,7 @@ struct Message
 // Queue
 bool CreateQueue() 
 {
-    xQueue = xQueueCreate( 10, sizeof( struct Message * ) );           // Queue that can hold 10 pointers of Message Struct
+    xQueue = slab_queue_create( 10, sizeof( struct Message * ) );      // Queue that can hold 10 pointers of Message Struct (memory from the slab allocator)
     if (xQueue == 0)
         return false;                                                  // Failed to create a Queue
     
@@ -47,9 +49,19 @@ TaskHandle_t create_task (void (*task_to_run)())
     return xHandle;
 }
 
+// Called by the slab allocator when it runs out of memory. Returning true makes the allocator try again (only after
+// freeing some memory, or it retries in a busy loop), false makes the allocation fail.
+bool OnOutOfMemory(size_t size, void* arg)
+{
+    ESP_LOGE(TAG, "Out of memory allocating %u bytes.", (unsigned)size);
+    slab_print_stats();
+    return false;
+}
+
 void Task(void* pvParameters)
 {
-    while(xQueue == 0 || xQueue == NULL);                           // Wait until the data is written in the queue
+    while(xQueue == 0 || xQueue == NULL)                            // Wait until the data is written in the queue
+        vTaskDelay(1);
     
     struct Message msg;
 
@@ -62,7 +74,9 @@ void Task(void* pvParameters)
         ESP_LOGI(TAG, "Message %s:", msg.data);
     }
 
-    while (1) {}
+    while (1) {
+        vTaskDelay(portMAX_DELAY);
+    }
 }
 
 
@@ -71,15 +85,18 @@ void app_main(void)
     ESP_LOGI(TAG, "Starting the Program.");
 
     xQueue = NULL;
-    bool queueCreatedSuccessfull = false;
     struct Message msg;
 
+    // Report allocation failures, instead of retrying in a busy loop that never gives the heap a chance to recover
+    slab_set_oom_callback(OnOutOfMemory, NULL);
+
     // Create a task to receive the msg
     xTask = create_task(Task);
 
-    while(!queueCreatedSuccessfull)                     // keep trying to create a queue until successfully created.
+    if (!CreateQueue())
     {
-        queueCreatedSuccessfull = CreateQueue();
+        ESP_LOGE(TAG, "Failed to create the Queue. Quitting.");
+        return;
     }
 
     msg.messageId = 'S';
@@ -101,6 +118,6 @@ void app_main(void)
 
     // Main loop   
     while (1) {
-
+        vTaskDelay(portMAX_DELAY);
     }
 }
@@ -0,0 +1,240 @@
+/*
+Slab allocator vs. the default heap.
+
+Over weeks of uptime, creating and deleting RTOS objects of different sizes (task stacks, TCBs, queues,
+message/stream buffers) and application payloads leaves free memory scattered in small holes: there may be
+plenty of free heap in total, but no single block large enough for the next task stack.
+
+The slab allocator (components/slab_alloc) rounds each request up to a size class and serves it from fixed
+size slabs, with a small cache of free objects per core. The heap itself only ever sees slab-sized blocks.
+
+This program runs the same churn workload on both allocators, one task per core, and prints after every
+round:
+    - steps per second (a step frees a random object and/or allocates a new one in its place)
+    - free heap and the largest free block, and heap fragmentation = 1 - largest block / free heap
+    - for the slab allocator, its per-size-class statistics
+
+The workload is generated by a fixed-seed random generator, so every run (and both allocators) sees exactly
+the same sequence of requests.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "slab_alloc.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+#define STACK_SIZE      4096
+#define NUM_SLOTS       48              // live objects per worker
+#define ROUNDS          5
+#define STEPS_PER_ROUND 200000
+#define LONG_LIVED      8               // slots 0..LONG_LIVED-1 are only replaced once per round
+
+// The slab allocator only uses internal RAM, so the heap runs and the heap figures use the same memory
+#if !CONFIG_IDF_TARGET_LINUX
+#define HEAP_CAPS       (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+static const char* TAG = "slab_bench";
+
+typedef struct {
+    const char* name;
+    void* (*alloc)(size_t size);
+    void (*release)(void* ptr);
+} allocator_t;
+
+typedef struct {
+    const allocator_t* allocator;
+    uint32_t seed;
+    uint32_t failures;
+    TaskHandle_t notify;                // task to notify when the round is done
+} worker_t;
+
+static void* heap_alloc(size_t size)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return malloc(size);
+#else
+    return heap_caps_malloc(size, HEAP_CAPS);
+#endif
+}
+
+static void heap_release(void* ptr)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    free(ptr);
+#else
+    heap_caps_free(ptr);
+#endif
+}
+
+static const allocator_t heapAllocator = { "heap", heap_alloc, heap_release };
+static const allocator_t slabAllocator = { "slab", slab_malloc, slab_free };
+
+
+static uint32_t next_random(uint32_t* seed)
+{
+    // xorshift32
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// Sizes seen when creating RTOS objects and passing messages around
+static size_t next_size(uint32_t* seed)
+{
+    uint32_t r = next_random(seed) % 100;
+
+    if (r < 10) return 2048;                                // task stack
+    if (r < 20) return 360;                                 // TCB
+    if (r < 30) return 80 + 10 * sizeof(void*);             // queue of 10 pointers
+    if (r < 40) return 104 + 40;                            // message buffer
+    if (r < 45) return 3000 + next_random(seed) % 1000;     // large buffer, beyond the largest size class
+    return 16 + next_random(seed) % 240;                    // payload
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_heap(void)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    size_t freeBytes = heap_caps_get_free_size(HEAP_CAPS);
+    size_t largest = heap_caps_get_largest_free_block(HEAP_CAPS);
+
+    ESP_LOGI(TAG, "Heap free %u, largest block %u, fragmentation %.1f%%, min free %u",
+             (unsigned)freeBytes, (unsigned)largest,
+             freeBytes > 0 ? 100.0f * (1.0f - (float)largest / (float)freeBytes) : 0.0f,
+             (unsigned)heap_caps_get_minimum_free_size(HEAP_CAPS));
+#endif
+}
+
+static void print_round(const char* name, int round, int64_t elapsedUs)
+{
+    uint32_t stepsPerSecond = elapsedUs > 0 ? (uint32_t)((int64_t)STEPS_PER_ROUND * portNUM_PROCESSORS * 1000000 / elapsedUs) : 0;
+
+    ESP_LOGI(TAG, "%s round %d: %lld us, %u steps/s", name, round, (long long)elapsedUs, (unsigned)stepsPerSecond);
+    print_heap();
+}
+
+// One worker per core: on every step, frees the object in a random slot and (every other step) allocates a new one
+void churn_task(void* pvParameters)
+{
+    worker_t* worker = (worker_t*)pvParameters;
+    const allocator_t* allocator = worker->allocator;
+    void* slots[NUM_SLOTS] = { NULL };
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        for (int step = 0; step < STEPS_PER_ROUND; ++step)
+        {
+            uint32_t slot = LONG_LIVED + next_random(&worker->seed) % (NUM_SLOTS - LONG_LIVED);
+            bool replace = false;
+
+            // The long lived objects pin memory between the short lived ones, which is what fragments a heap
+            if (step % (STEPS_PER_ROUND / LONG_LIVED) == 0)
+            {
+                slot = step / (STEPS_PER_ROUND / LONG_LIVED);
+                replace = true;
+            }
+
+            if (slots[slot] != NULL)
+            {
+                allocator->release(slots[slot]);
+                slots[slot] = NULL;
+            }
+
+            if (replace || step % 2 == 0)
+            {
+                size_t size = next_size(&worker->seed);
+
+                slots[slot] = allocator->alloc(size);
+                if (slots[slot] == NULL)
+                    ++worker->failures;
+                else
+                    memset(slots[slot], 0xA5, size);        // touch the memory, as a real user would
+            }
+        }
+
+        xTaskNotifyGive(worker->notify);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);            // wait for the stats to be printed
+    }
+
+    for (int slot = 0; slot < NUM_SLOTS; ++slot)
+        allocator->release(slots[slot]);
+
+    xTaskNotifyGive(worker->notify);
+    vTaskDelete(NULL);
+}
+
+static void run_benchmark(const allocator_t* allocator)
+{
+    static worker_t workers[portNUM_PROCESSORS];
+    TaskHandle_t tasks[portNUM_PROCESSORS];
+
+    ESP_LOGI(TAG, "Running %d rounds of %d steps per core on the %s allocator.", ROUNDS, STEPS_PER_ROUND, allocator->name);
+
+    int64_t start = now_us();
+
+    for (int core = 0; core < portNUM_PROCESSORS; ++core)
+    {
+        workers[core] = (worker_t) {
+            .allocator = allocator,
+            .seed = 0x1234567u + core,                      // same sequence for both allocators
+            .failures = 0,
+            .notify = xTaskGetCurrentTaskHandle(),
+        };
+        xTaskCreatePinnedToCore(churn_task, "churn", STACK_SIZE, &workers[core], tskIDLE_PRIORITY + 1, &tasks[core], core);
+        configASSERT( tasks[core] );
+    }
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        for (int core = 0; core < portNUM_PROCESSORS; ++core)
+            ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        int64_t end = now_us();
+        print_round(allocator->name, round, end - start);
+        if (allocator == &slabAllocator)
+            slab_print_stats();
+
+        start = now_us();
+        for (int core = 0; core < portNUM_PROCESSORS; ++core)
+            xTaskNotifyGive(tasks[core]);
+    }
+
+    // Wait for the workers to free everything
+    for (int core = 0; core < portNUM_PROCESSORS; ++core)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+    for (int core = 0; core < portNUM_PROCESSORS; ++core)
+        ESP_LOGI(TAG, "%s: %u failed allocations on core %d", allocator->name, (unsigned)workers[core].failures, core);
+}
+
+void app_main(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_VERBOSE);
+    ESP_LOGI(TAG, "Starting the Slab Allocator Benchmark");
+
+    run_benchmark(&heapAllocator);
+    run_benchmark(&slabAllocator);
+
+    slab_trim();
+    ESP_LOGI(TAG, "After trimming the slab allocator:");
+    print_heap();
+}
@@ -36,6 +36,7 @@ Here are some key features and characteristics of stream buffers:
 #include "freertos/task.h"
 #include "freertos/stream_buffer.h"
 #include "esp_log.h"
+#include "slab_rtos.h"
 
 static const char* TAG = "MyModule";
 
@@ -78,7 +79,9 @@ void task()
     }
     
     while(1) 
-    {}
+    {
+        vTaskDelay(portMAX_DELAY);
+    }
 }
 
 void app_main(void)
@@ -111,7 +114,8 @@ void app_main(void)
     //                      actually available in the buffer. Setting a trigger level of 0 will effectively use a trigger level of 1. It is not 
     //                      valid to specify a trigger level greater than the buffer size.
 
-    buffer = xStreamBufferCreate( xStreamBufferSizeBytes, xTriggerLevel );
+    // slab_stream_buffer_create takes the same parameters as xStreamBufferCreate, but the buffer comes from the slab allocator
+    buffer = slab_stream_buffer_create( xStreamBufferSizeBytes, xTriggerLevel );
 
 
     // 3. ********** Writing to the message Buffer ***********
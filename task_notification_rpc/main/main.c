@@ -0,0 +1,334 @@
+/*
+Request/response between tasks: message buffers vs. task notification RPC.
+
+The message_buffer and stream_buffer examples make a request/confirmation round trip over a buffer: the main
+task writes the request, the other task reads it and writes a confirmation string back, and the main task
+reads that. Only one request is ever in flight, and every reply is a copy of the string through the buffer
+plus a context switch for each direction.
+
+components/task_rpc does the same with a queue of request pointers to the server, and a direct-to-task
+notification back to the caller. The reply is a status and a pointer left in the request, nothing is copied,
+and a client can keep several requests in flight.
+
+This program measures, with the server on the other core:
+    1. buffers:        request and confirmation through message buffers, one at a time
+    2. rpc call:       task_rpc_call(), one at a time
+    3. rpc pipelined:  CONFIG_TASK_RPC_MAX_OUTSTANDING requests kept in flight with task_rpc_send()/wait_any()
+
+and prints the average round-trip latency and the requests per second of each.
+
+It then checks the timeout path of task_rpc: a call that times out while its handler is still running, the
+abandoned request holding its slot until the handler returns, later requests in that slot getting their own
+results, and deleting a client that still has a request in the server.
+
+The buffer version uses one buffer per direction. With a single buffer for both, as in the examples, the main
+task has to sleep long enough for the other task to take the request before it reads, otherwise it would read
+its own request back; those sleeps are left out here so only the mechanism itself is measured.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/message_buffer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "task_rpc.h"
+
+#define STACK_SIZE      2048
+#define SERVER_PRIORITY 5
+#define SERVER_CORE     (portNUM_PROCESSORS - 1)        // the other core, when there is one
+#define ITERATIONS      10000
+#define OP_READ         1
+#define OP_ECHO         2               // result is the uint32_t payload
+#define OP_SLOW         3               // same, after SLOW_MS
+#define SLOW_MS         50
+
+static const char* TAG = "rpc_bench";
+static const char* confirmation = "Data Successfully read from the Task";
+
+MessageBufferHandle_t requestBuffer;
+MessageBufferHandle_t replyBuffer;
+
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_result(const char* name, int64_t elapsedUs, int64_t latencySumUs)
+{
+    ESP_LOGI(TAG, "%-14s %6lld us/request round trip, %7lld requests/s",
+             name, (long long)(latencySumUs / ITERATIONS), elapsedUs > 0 ? (long long)(ITERATIONS * 1000000LL / elapsedUs) : 0LL);
+}
+
+
+// 1. ********** Message buffers **********
+
+void buffer_server_task(void* pvParameters)
+{
+    uint8_t ucArraytoReceive[4];
+
+    while (1)
+    {
+        if (xMessageBufferReceive(requestBuffer, (void *)ucArraytoReceive, sizeof(ucArraytoReceive), portMAX_DELAY) == sizeof(ucArraytoReceive))
+            xMessageBufferSend(replyBuffer, (void *)confirmation, strlen(confirmation) + 1, portMAX_DELAY);
+    }
+}
+
+static void benchmark_buffers(void)
+{
+    TaskHandle_t server = NULL;
+    uint8_t ucArrayToSend[] = {0,1,2,3};
+    char ucArraytoReceive[50];
+
+    requestBuffer = xMessageBufferCreate(104);
+    replyBuffer = xMessageBufferCreate(104);
+    configASSERT( requestBuffer && replyBuffer );
+
+    xTaskCreatePinnedToCore(buffer_server_task, "buffer_server", STACK_SIZE, NULL, SERVER_PRIORITY, &server, SERVER_CORE);
+    configASSERT( server );
+
+    int64_t start = now_us();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        xMessageBufferSend(requestBuffer, (void *)ucArrayToSend, sizeof(ucArrayToSend), portMAX_DELAY);
+        xMessageBufferReceive(replyBuffer, (void *)ucArraytoReceive, sizeof(ucArraytoReceive), portMAX_DELAY);
+    }
+    int64_t elapsed = now_us() - start;
+
+    print_result("buffers", elapsed, elapsed);        // one at a time: latency = elapsed / iterations
+
+    vTaskDelete(server);
+    vMessageBufferDelete(requestBuffer);
+    vMessageBufferDelete(replyBuffer);
+}
+
+
+// 2. and 3. ********** Task RPC **********
+
+// Runs in the RPC server task. The confirmation goes back as a pointer, nothing is copied.
+static esp_err_t read_handler(uint32_t op, const void* payload, size_t payloadLen, void** result, void* ctx)
+{
+    if (payloadLen != 4)
+        return ESP_ERR_INVALID_ARG;
+
+    uint32_t value;
+    memcpy(&value, payload, sizeof(value));
+
+    switch (op)
+    {
+    case OP_READ:
+        *result = (void *)confirmation;
+        return ESP_OK;
+
+    case OP_SLOW:
+        vTaskDelay(pdMS_TO_TICKS(SLOW_MS));
+        // fall through
+    case OP_ECHO:
+        *result = (void *)(uintptr_t)value;
+        return ESP_OK;
+
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static void benchmark_rpc_call(task_rpc_client_t client)
+{
+    uint8_t ucArrayToSend[] = {0,1,2,3};
+    void* reply;
+
+    int64_t start = now_us();
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        esp_err_t err = task_rpc_call(client, OP_READ, ucArrayToSend, sizeof(ucArrayToSend), pdMS_TO_TICKS(100), &reply);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Call %d failed: %s", i, esp_err_to_name(err));
+    }
+    int64_t elapsed = now_us() - start;
+
+    print_result("rpc call", elapsed, elapsed);
+}
+
+static void benchmark_rpc_pipelined(task_rpc_client_t client)
+{
+    // Send time of every request in flight, to work out its round trip when it completes
+    struct {
+        uint32_t id;
+        int64_t sentAt;
+    } inFlight[CONFIG_TASK_RPC_MAX_OUTSTANDING] = { 0 };
+
+    uint8_t ucArrayToSend[] = {0,1,2,3};
+    int sent = 0;
+    int completed = 0;
+    int64_t latencySum = 0;
+
+    int64_t start = now_us();
+    while (completed < ITERATIONS)
+    {
+        // Top up to the maximum number of requests in flight
+        for (int i = 0; i < CONFIG_TASK_RPC_MAX_OUTSTANDING && sent < ITERATIONS; ++i)
+        {
+            if (inFlight[i].id != 0)
+                continue;
+
+            if (task_rpc_send(client, OP_READ, ucArrayToSend, sizeof(ucArrayToSend), &inFlight[i].id) != ESP_OK)
+                break;
+
+            inFlight[i].sentAt = now_us();
+            ++sent;
+        }
+
+        uint32_t id;
+        void* reply;
+        esp_err_t err = task_rpc_wait_any(client, pdMS_TO_TICKS(100), &id, &reply);
+        if (err == ESP_ERR_TIMEOUT)
+        {
+            ESP_LOGE(TAG, "No reply within 100 ms");
+            break;
+        }
+
+        if (err == ESP_ERR_NOT_FOUND)           // nothing in flight, the server queue was full
+            continue;
+
+        int64_t now = now_us();
+        for (int i = 0; i < CONFIG_TASK_RPC_MAX_OUTSTANDING; ++i)
+        {
+            if (inFlight[i].id == id)
+            {
+                latencySum += now - inFlight[i].sentAt;
+                inFlight[i].id = 0;
+                break;
+            }
+        }
+        ++completed;
+    }
+    int64_t elapsed = now_us() - start;
+
+    print_result("rpc pipelined", elapsed, latencySum);
+}
+
+// 4. ********** Timeouts **********
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            ESP_LOGE(TAG, "Timeout check failed at line %d: %s", __LINE__, #cond); \
+            return false;                                               \
+        }                                                               \
+    } while (0)
+
+// Send count OP_ECHO requests, then collect them all and check that each one got its own value back
+static bool echo_round(task_rpc_client_t client, uint32_t firstValue, int count)
+{
+    uint32_t ids[CONFIG_TASK_RPC_MAX_OUTSTANDING];
+
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t value = firstValue + i;
+        CHECK(task_rpc_send(client, OP_ECHO, &value, sizeof(value), &ids[i]) == ESP_OK);
+    }
+
+    for (int n = 0; n < count; ++n)
+    {
+        uint32_t id;
+        void* reply;
+        CHECK(task_rpc_wait_any(client, pdMS_TO_TICKS(1000), &id, &reply) == ESP_OK);
+
+        int i = 0;
+        while (i < count && ids[i] != id)
+            ++i;
+        CHECK(i < count);
+        CHECK((uintptr_t)reply == firstValue + i);
+        ids[i] = 0;
+    }
+
+    return true;
+}
+
+static bool timeout_steps(task_rpc_client_t client)
+{
+    uint32_t value = 1;
+    uint32_t id;
+    void* reply = NULL;
+
+    // The handler takes SLOW_MS, so the call gives up first and abandons the request
+    CHECK(task_rpc_call(client, OP_SLOW, &value, sizeof(value), pdMS_TO_TICKS(10), &reply) == ESP_ERR_TIMEOUT);
+
+    // While the handler runs, the abandoned request still holds its slot
+    for (int i = 0; i < CONFIG_TASK_RPC_MAX_OUTSTANDING - 1; ++i)
+    {
+        value = 100 + i;
+        CHECK(task_rpc_send(client, OP_ECHO, &value, sizeof(value), &id) == ESP_OK);
+    }
+    CHECK(task_rpc_send(client, OP_ECHO, &value, sizeof(value), &id) == ESP_ERR_NO_MEM);
+
+    for (int i = 0; i < CONFIG_TASK_RPC_MAX_OUTSTANDING - 1; ++i)
+        CHECK(task_rpc_wait_any(client, pdMS_TO_TICKS(1000), &id, &reply) == ESP_OK);
+    CHECK(task_rpc_wait_any(client, 0, &id, &reply) == ESP_ERR_NOT_FOUND);
+
+    // The server ran those after the slow handler returned, so every slot is free again, and the one the
+    // abandoned request used must not hand out its result (1)
+    CHECK(echo_round(client, 200, CONFIG_TASK_RPC_MAX_OUTSTANDING));
+    CHECK(echo_round(client, 300, CONFIG_TASK_RPC_MAX_OUTSTANDING));
+
+    // Leave a request running in the server for task_rpc_client_delete()
+    value = 2;
+    CHECK(task_rpc_send(client, OP_SLOW, &value, sizeof(value), &id) == ESP_OK);
+    CHECK(task_rpc_wait(client, id, pdMS_TO_TICKS(10), &reply) == ESP_ERR_TIMEOUT);
+
+    return true;
+}
+
+static bool check_timeouts(task_rpc_server_t server)
+{
+    task_rpc_client_t client;
+
+    CHECK(task_rpc_client_create(server, &client) == ESP_OK);
+
+    bool passed = timeout_steps(client);
+
+    // Waits for the server to let go of whatever the client still has in it, so it must come back
+    task_rpc_client_delete(client);
+    return passed;
+}
+
+static void benchmark_rpc(void)
+{
+    task_rpc_server_config_t config = TASK_RPC_SERVER_CONFIG_DEFAULT();
+    config.handler = read_handler;
+    config.name = "rpc_server";
+    config.priority = SERVER_PRIORITY;
+    config.coreId = SERVER_CORE;
+
+    task_rpc_server_t server;
+    task_rpc_client_t client;
+
+    ESP_ERROR_CHECK(task_rpc_server_create(&config, &server));
+    ESP_ERROR_CHECK(task_rpc_client_create(server, &client));
+
+    benchmark_rpc_call(client);
+    benchmark_rpc_pipelined(client);
+
+    task_rpc_client_delete(client);
+
+    if (check_timeouts(server))
+        ESP_LOGI(TAG, "Timeout check passed");
+
+    task_rpc_server_delete(server);
+}
+
+void app_main(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_VERBOSE);
+    ESP_LOGI(TAG, "Starting the RPC Benchmark: %d requests each, server on core %d", ITERATIONS, SERVER_CORE);
+
+    benchmark_buffers();
+    benchmark_rpc();
+}